@@ -0,0 +1,289 @@
+/**
+ * @file cluster.c
+ * @brief 对称集群模块
+ *
+ * 主要功能：
+ * 1. 各节点在LAN广播优先级、健康状态和持有状态
+ * 2. 按 健康 > 优先级 > 节点地址 选举虚拟网关持有者
+ * 3. 抢占延迟与双持有者仲裁，避免频繁切换和脑裂
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include "cluster.h"
+#include "network.h"
+#include "peer.h"
+#include "dhcp.h"
+#include "side.h"
+
+// 已知节点
+struct cluster_node {
+    uint32_t node;          // 节点地址（网络字节序）
+    struct gw_advert last;  // 最近一次通告
+    time_t seen;            // 接收时间（单调时钟秒）
+};
+
+/**
+ * 计算选举键值，越大越优先
+ * 健康节点总是优先于不健康节点，其次比较优先级，最后以地址较大者胜出
+ */
+static unsigned long long election_key(int healthy, int priority, uint32_t node) {
+    return ((unsigned long long)(healthy ? 1 : 0) << 40) |
+           ((unsigned long long)priority << 32) | ntohl(node);
+}
+
+static unsigned long long advert_key(const struct gw_advert *adv) {
+    return election_key(adv->flags & ADVERT_F_HEALTHY, adv->priority, adv->node);
+}
+
+/**
+ * 根据虚拟网关地址和掩码计算子网广播地址，并确定本机在该子网的地址
+ * @return 0=成功，-1=失败
+ *
+ * 节点标识取LAN设备上与虚拟网关同网段的地址，并排除虚拟IP本身：
+ * 若以持有者身份重启，虚拟IP可能仍在接口上，误用为标识会导致两个节点标识相同。
+ */
+static int resolve_addrs(const struct config *cfg, char *bcast, size_t len, uint32_t *self) {
+    struct in_addr ip, mask, bc;
+    struct ifaddrs *ifa_list, *ifa;
+
+    if (inet_pton(AF_INET, cfg->interface.ipaddr, &ip) != 1 ||
+        inet_pton(AF_INET, cfg->interface.netmask, &mask) != 1) {
+        syslog(LOG_ERR, "[Cluster] 虚拟网关地址或掩码无效");
+        return -1;
+    }
+    bc.s_addr = ip.s_addr | ~mask.s_addr;
+    inet_ntop(AF_INET, &bc, bcast, len);
+
+    if (getifaddrs(&ifa_list) < 0) {
+        return -1;
+    }
+    *self = 0;
+    for (ifa = ifa_list; ifa; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET ||
+            strcmp(ifa->ifa_name, cfg->interface.device) != 0) {
+            continue;
+        }
+        uint32_t addr = ((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr;
+        if (addr != ip.s_addr && (addr & mask.s_addr) == (ip.s_addr & mask.s_addr)) {
+            *self = addr;
+            break;
+        }
+    }
+    freeifaddrs(ifa_list);
+
+    if (*self == 0) {
+        syslog(LOG_ERR, "[Cluster] %s 上没有与虚拟网关同网段的本机地址", cfg->interface.device);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 创建发送通告的套接字，绑定到本机节点地址，保证通告的源地址即节点标识
+ * @return 套接字描述符，-1=失败
+ */
+static int open_sender(uint32_t self) {
+    struct sockaddr_in addr;
+    int on = 1;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = self;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * 判断地址是否为本机地址（用于过滤回环的广播）
+ */
+static int is_local_addr(struct in_addr addr) {
+    struct ifaddrs *ifa_list, *ifa;
+    int local = 0;
+
+    if (getifaddrs(&ifa_list) < 0) {
+        return 0;
+    }
+    for (ifa = ifa_list; ifa; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET &&
+            ((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr == addr.s_addr) {
+            local = 1;
+            break;
+        }
+    }
+    freeifaddrs(ifa_list);
+    return local;
+}
+
+/**
+ * 检查LAN设备载波，失去载波的节点听不到其他节点，不能参与选举
+ * @return 1=有载波，0=无载波
+ */
+static int lan_carrier(const char *device) {
+    char path[64];
+    int carrier = 1;
+
+    snprintf(path, sizeof(path), "/sys/class/net/%s/carrier", device);
+    FILE *fp = fopen(path, "r");
+    if (fp) {
+        if (fscanf(fp, "%d", &carrier) != 1) {
+            carrier = 1;
+        }
+        fclose(fp);
+    }
+    return carrier;
+}
+
+/**
+ * 接收通告并更新节点表
+ */
+static void update_nodes(int fd, struct cluster_node *nodes, int *count) {
+    struct gw_advert adv;
+    struct in_addr from;
+
+    while (peer_recv(fd, &adv, &from)) {
+        // 广播会回环到本机，按报文源地址过滤；节点标识须与源地址一致，否则丢弃
+        if (is_local_addr(from) || adv.node != from.s_addr) {
+            continue;
+        }
+        int i;
+        for (i = 0; i < *count; i++) {
+            if (nodes[i].node == adv.node) {
+                break;
+            }
+        }
+        if (i == *count) {
+            if (*count >= CLUSTER_MAX_NODES) {
+                continue;
+            }
+            (*count)++;
+            syslog(LOG_INFO, "[Cluster] 发现节点 %s", inet_ntoa(from));
+        }
+        nodes[i].node = adv.node;
+        nodes[i].last = adv;
+        nodes[i].seen = monotonic_sec();
+    }
+}
+
+/**
+ * 集群主循环
+ * @param cfg 配置结构体
+ *
+ * 选举规则：
+ * 1. 启动后先监听dead_interval秒，了解现有持有者后才参与选举
+ * 2. 本机键值最高且无其他持有者时立即接管
+ * 3. 现持有者不健康而本机健康时立即接管；否则需持续占优preempt_delay秒才抢占
+ * 4. 出现多个持有者时，键值较低者立即释放
+ * @return 初始化失败返回-1，否则不返回
+ */
+int cluster_loop(struct config *cfg) {
+    struct cluster_node nodes[CLUSTER_MAX_NODES];
+    int count = 0;
+    char bcast[INET_ADDRSTRLEN];
+    uint32_t self;
+    int owner = 0;
+    time_t start = monotonic_sec();
+    time_t preempt_since = 0;
+
+    syslog(LOG_INFO, "[Cluster] 集群服务已启动，优先级%d", cfg->cluster.priority);
+    // 先释放可能残留的虚拟IP，再确定节点标识
+    disable_network_interface("virtual_gw");
+    int fd = peer_open(cfg->global.advert_port);
+    int send_fd = -1;
+    if (fd < 0 || resolve_addrs(cfg, bcast, sizeof(bcast), &self) != 0 ||
+        (send_fd = open_sender(self)) < 0) {
+        syslog(LOG_CRIT, "[Cluster] 集群初始化失败");
+        return -1;
+    }
+
+    while (1) {
+        int healthy = detect_wan_connectivity(cfg->global.detect_src_addr) == 0;
+        time_t now = monotonic_sec();
+        unsigned long long my_key = election_key(healthy, cfg->cluster.priority, self);
+
+        update_nodes(fd, nodes, &count);
+
+        // 统计在线节点中的最高键值与持有者
+        unsigned long long best_other = 0;
+        const struct gw_advert *other_owner = NULL;
+        int any_healthy = healthy;
+        for (int i = 0; i < count; i++) {
+            if (now - nodes[i].seen > cfg->cluster.dead_interval) {
+                continue;
+            }
+            unsigned long long key = advert_key(&nodes[i].last);
+            if (key > best_other) {
+                best_other = key;
+            }
+            if (nodes[i].last.flags & ADVERT_F_HEALTHY) {
+                any_healthy = 1;
+            }
+            if ((nodes[i].last.flags & ADVERT_F_OWNER) &&
+                (!other_owner || key > advert_key(other_owner))) {
+                other_owner = &nodes[i].last;
+            }
+        }
+
+        if (!lan_carrier(cfg->interface.device)) {
+            // 与其他节点失联，不能据此判断自己是否应持有
+            if (owner) {
+                syslog(LOG_NOTICE, "[Cluster] LAN失去载波，释放网关");
+            }
+            owner = 0;
+            preempt_since = 0;
+        } else if (owner) {
+            if (other_owner && advert_key(other_owner) > my_key) {
+                syslog(LOG_NOTICE, "[Cluster] 存在更优持有者，释放网关");
+                owner = 0;
+            }
+        } else if (now - start < cfg->cluster.dead_interval) {
+            // 启动监听期
+        } else if (my_key > best_other) {
+            if (!other_owner ||
+                (healthy && !(other_owner->flags & ADVERT_F_HEALTHY))) {
+                syslog(LOG_NOTICE, "[Cluster] 本机当选，接管网关");
+                owner = 1;
+            } else if (!preempt_since) {
+                preempt_since = now;
+            } else if (now - preempt_since >= cfg->cluster.preempt_delay) {
+                syslog(LOG_NOTICE, "[Cluster] 抢占延迟已到，接管网关");
+                owner = 1;
+            }
+        } else {
+            preempt_since = 0;
+        }
+        if (owner) {
+            preempt_since = 0;
+        }
+
+        if (owner) {
+            enable_network_interface("virtual_gw");
+        } else {
+            disable_network_interface("virtual_gw");
+        }
+        dhcp_publish_gateway(cfg, !any_healthy);
+
+        struct gw_advert adv = {
+            .priority = cfg->cluster.priority,
+            .flags = (owner ? ADVERT_F_OWNER : 0) | (healthy ? ADVERT_F_HEALTHY : 0),
+            .node = self,
+        };
+        peer_send(send_fd, bcast, cfg->global.advert_port, &adv);
+
+        sleep(cfg->global.check_interval);
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "config.h"
+
+// 集群最大节点数（不含本机）
+#define CLUSTER_MAX_NODES 16
+
+int cluster_loop(struct config *cfg);
+
+#endif
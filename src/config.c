@@ -1,8 +1,12 @@
 #include "config.h"
+#include "peer.h"
+#include "dhcp.h"
+#include "network.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <syslog.h>
+#include <arpa/inet.h>
 
 
 /**
@@ -53,8 +57,9 @@ config_error_t config_load(struct config *cfg) {
     
     // 验证state值
     if (strcmp(cfg->global.state, "master") != 0 && 
-        strcmp(cfg->global.state, "side") != 0) {
-        syslog(LOG_ERR, "[Config] state值必须为master或side");
+        strcmp(cfg->global.state, "side") != 0 &&
+        strcmp(cfg->global.state, "cluster") != 0) {
+        syslog(LOG_ERR, "[Config] state值必须为master、side或cluster");
         res = CONFIG_ERR_INVALID_VALUE;
         goto cleanup;
     }
@@ -68,6 +73,101 @@ config_error_t config_load(struct config *cfg) {
     
     cfg->global.check_interval = uci_get_int_default(ctx, global_sec, "check_interval", 2);
 
+    const char *wan_device = uci_lookup_option_string(ctx, global_sec, "wan_device");
+    if (wan_device) {
+        strncpy(cfg->global.wan_device, wan_device, MAX_DEVICE_LEN - 1);
+    }
+
+    cfg->global.advert_port = uci_get_int_default(ctx, global_sec, "advert_port", DEFAULT_ADVERT_PORT);
+
+    cfg->global.loadshare = uci_get_bool_default(ctx, global_sec, "loadshare", 0);
+    cfg->global.lb_weight = uci_get_int_default(ctx, global_sec, "lb_weight", DEFAULT_LB_WEIGHT);
+    if (cfg->global.lb_weight < 1 || cfg->global.lb_weight > 99) {
+        syslog(LOG_ERR, "[Config] lb_weight值必须在1-99之间");
+        res = CONFIG_ERR_INVALID_VALUE;
+        goto cleanup;
+    }
+
+    const char *peer_addr = uci_lookup_option_string(ctx, global_sec, "peer_addr");
+    if (peer_addr) {
+        strncpy(cfg->global.peer_addr, peer_addr, MAX_IP_LEN - 1);
+    }
+    // 旁路由需要检测主路由才能在其故障时接管全部客户端
+    if (cfg->global.loadshare && strcmp(cfg->global.state, "side") == 0 &&
+        cfg->global.peer_addr[0] == '\0') {
+        syslog(LOG_ERR, "[Config] 旁路由开启loadshare时必须配置peer_addr");
+        res = CONFIG_ERR_INVALID_VALUE;
+        goto cleanup;
+    }
+
+    cfg->capacity.enabled = uci_get_bool_default(ctx, global_sec, "capacity", 0);
+    cfg->capacity.wan_capacity = uci_get_int_default(ctx, global_sec, "wan_capacity", 0);
+    cfg->capacity.high = uci_get_int_default(ctx, global_sec, "load_high", DEFAULT_LOAD_HIGH);
+    cfg->capacity.low = uci_get_int_default(ctx, global_sec, "load_low", DEFAULT_LOAD_LOW);
+    cfg->capacity.sustain = uci_get_int_default(ctx, global_sec, "load_sustain", DEFAULT_LOAD_SUSTAIN);
+    cfg->capacity.hold = uci_get_int_default(ctx, global_sec, "load_hold", DEFAULT_LOAD_HOLD);
+    cfg->capacity.margin = uci_get_int_default(ctx, global_sec, "load_margin", DEFAULT_LOAD_MARGIN);
+    cfg->capacity.shed = uci_get_int_default(ctx, global_sec, "load_shed", DEFAULT_LOAD_SHED);
+    if (cfg->capacity.enabled) {
+        // 高低阈值之间留出回差，避免负载在阈值附近时反复切换
+        if (cfg->capacity.low >= cfg->capacity.high || cfg->capacity.high > 100 ||
+            cfg->capacity.low < 0 || cfg->capacity.sustain < 1) {
+            syslog(LOG_ERR, "[Config] 负载阈值无效，须满足0<=load_low<load_high<=100且load_sustain>=1");
+            res = CONFIG_ERR_INVALID_VALUE;
+            goto cleanup;
+        }
+        if (cfg->capacity.shed < 0 || cfg->capacity.shed >= LB_BUCKETS ||
+            cfg->capacity.hold < 0 ||
+            cfg->capacity.margin < 0 || cfg->capacity.margin > 100) {
+            syslog(LOG_ERR, "[Config] 须满足0<=load_shed<100、load_hold>=0、0<=load_margin<=100");
+            res = CONFIG_ERR_INVALID_VALUE;
+            goto cleanup;
+        }
+        if (strcmp(cfg->global.state, "side") == 0 && cfg->global.peer_addr[0] == '\0') {
+            syslog(LOG_ERR, "[Config] 旁路由开启capacity时必须配置peer_addr");
+            res = CONFIG_ERR_INVALID_VALUE;
+            goto cleanup;
+        }
+    }
+
+    cfg->dhcp.steer = uci_get_bool_default(ctx, global_sec, "dhcp_steer", 0);
+    const char *dhcp_tag = uci_lookup_option_string(ctx, global_sec, "dhcp_tag");
+    strncpy(cfg->dhcp.tag, dhcp_tag ? dhcp_tag : "lan", MAX_NAME_LEN - 1);
+    const char *fallback_gw = uci_lookup_option_string(ctx, global_sec, "dhcp_fallback_gw");
+    if (fallback_gw) {
+        strncpy(cfg->dhcp.fallback_gw, fallback_gw, MAX_IP_LEN - 1);
+    }
+    cfg->dhcp.renew = uci_get_int_default(ctx, global_sec, "dhcp_renew", DEFAULT_DHCP_RENEW);
+    if (cfg->dhcp.steer && cfg->dhcp.renew < 60) {
+        syslog(LOG_ERR, "[Config] dhcp_renew不能小于60秒");
+        res = CONFIG_ERR_INVALID_VALUE;
+        goto cleanup;
+    }
+
+    cfg->cluster.priority = uci_get_int_default(ctx, global_sec, "priority", DEFAULT_PRIORITY);
+    cfg->cluster.preempt_delay = uci_get_int_default(ctx, global_sec, "preempt_delay", DEFAULT_PREEMPT_DELAY);
+    // 默认容忍丢失3个通告；单轮外网检测最长约8秒，一并计入
+    cfg->cluster.dead_interval = uci_get_int_default(ctx, global_sec, "dead_interval",
+                                                     cfg->global.check_interval * 3 + 8);
+    if (strcmp(cfg->global.state, "cluster") == 0) {
+        if (cfg->cluster.priority < 1 || cfg->cluster.priority > 254) {
+            syslog(LOG_ERR, "[Config] priority值必须在1-254之间");
+            res = CONFIG_ERR_INVALID_VALUE;
+            goto cleanup;
+        }
+        if (cfg->cluster.dead_interval <= 0 || cfg->cluster.preempt_delay < 0) {
+            syslog(LOG_ERR, "[Config] 须满足dead_interval>0且preempt_delay>=0");
+            res = CONFIG_ERR_INVALID_VALUE;
+            goto cleanup;
+        }
+        // 负载分担与负载感知切换依赖主/旁路由的固定分工
+        if (cfg->global.loadshare || cfg->capacity.enabled) {
+            syslog(LOG_ERR, "[Config] cluster模式不支持loadshare与capacity");
+            res = CONFIG_ERR_INVALID_VALUE;
+            goto cleanup;
+        }
+    }
+
     //------------------- 解析interface段 --------------------
     struct uci_section *if_sec = uci_lookup_section(ctx, pkg, "virtual_gw");
     if (!if_sec) {
@@ -90,6 +190,12 @@ config_error_t config_load(struct config *cfg) {
         res = CONFIG_ERR_INVALID_VALUE;
         goto cleanup;
     }
+    struct in_addr addr;
+    if (inet_pton(AF_INET, ipaddr, &addr) != 1) {
+        syslog(LOG_ERR, "[Config] ipaddr必须为IPv4地址：%s", ipaddr);
+        res = CONFIG_ERR_INVALID_VALUE;
+        goto cleanup;
+    }
     strncpy(cfg->interface.ipaddr, ipaddr, MAX_IP_LEN - 1);
     
     const char *netmask = uci_lookup_option_string(ctx, if_sec, "netmask");
@@ -98,8 +204,35 @@ config_error_t config_load(struct config *cfg) {
         res = CONFIG_ERR_INVALID_VALUE;
         goto cleanup;
     }
+    if (inet_pton(AF_INET, netmask, &addr) != 1) {
+        syslog(LOG_ERR, "[Config] netmask必须为点分十进制掩码：%s", netmask);
+        res = CONFIG_ERR_INVALID_VALUE;
+        goto cleanup;
+    }
     strncpy(cfg->interface.netmask, netmask, MAX_IP_LEN - 1);
 
+    cfg->interface.vmac = uci_get_bool_default(ctx, if_sec, "vmac", 0);
+    cfg->interface.vrid = uci_get_int_default(ctx, if_sec, "vrid", DEFAULT_VRID);
+    if (cfg->interface.vrid < 1 || cfg->interface.vrid > 255) {
+        syslog(LOG_ERR, "[Config] vrid值必须在1-255之间");
+        res = CONFIG_ERR_INVALID_VALUE;
+        goto cleanup;
+    }
+
+    // 负载分担依赖nftables的ARP过滤，fw3固件没有nft时直接拒绝，避免两台路由同时应答全部ARP
+    if (cfg->global.loadshare && system("command -v nft >/dev/null 2>&1") != 0) {
+        syslog(LOG_ERR, "[Config] 未找到nft，loadshare需要nftables（fw4）");
+        res = CONFIG_ERR_INVALID_VALUE;
+        goto cleanup;
+    }
+
+    // 负载分担要求两台路由以各自MAC应答ARP，不能共用虚拟MAC
+    if (cfg->global.loadshare && cfg->interface.vmac) {
+        syslog(LOG_ERR, "[Config] loadshare与vmac模式不能同时开启");
+        res = CONFIG_ERR_INVALID_VALUE;
+        goto cleanup;
+    }
+
 cleanup:
     if (pkg) uci_unload(ctx, pkg);
     uci_free_context(ctx);
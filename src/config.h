@@ -26,6 +26,23 @@ typedef enum {
 #define MAX_PROTO_LEN 16
 #define MAX_DEVICE_LEN 16
 #define MAX_NAME_LEN 64
+// 默认负载分担权重（主路由所占百分比）
+#define DEFAULT_LB_WEIGHT 50
+
+// 负载感知切换默认参数
+#define DEFAULT_LOAD_HIGH 85
+#define DEFAULT_LOAD_LOW 60
+#define DEFAULT_LOAD_SUSTAIN 5
+#define DEFAULT_LOAD_HOLD 300
+#define DEFAULT_LOAD_MARGIN 20
+#define DEFAULT_LOAD_SHED 25
+
+// 集群选举默认参数
+#define DEFAULT_PRIORITY 100
+#define DEFAULT_PREEMPT_DELAY 30
+
+// 默认虚拟路由ID
+#define DEFAULT_VRID 1
 
 /**
  * 完整配置结构体
@@ -35,16 +52,50 @@ struct config {
     /*----- 全局配置 -----*/
     struct {
         int log_level;      // 日志级别 0-关闭 1-基础 2-详细
-        char state[16];     // 路由状态 master/side
+        char state[16];     // 路由状态 master/side/cluster
         char detect_src_addr[MAX_IP_LEN]; // 检测目标（可以是域名如www.baidu.com或IP地址）
         int check_interval; // 检测间隔（秒）
+        int loadshare;      // 负载分担模式 0-关闭 1-开启
+        int lb_weight;      // 负载分担时主路由承担的客户端比例（1-99，百分比）
+        char peer_addr[MAX_IP_LEN]; // 对端路由LAN地址（旁路由负载分担时检测主路由）
+        char wan_device[MAX_DEVICE_LEN]; // 外网设备名（如pppoe-wan），配置后监听内核事件立即检测
+        int advert_port;    // 路由间状态通告UDP端口
     } global;
 
+    /*----- 集群选举配置（state为cluster时生效） -----*/
+    struct {
+        int priority;       // 优先级（1-254），越大越优先持有虚拟网关
+        int preempt_delay;  // 抢占延迟（秒），高优先级节点需持续占优这么久才接管健康的持有者
+        int dead_interval;  // 通告超时（秒），超时的节点视为离线
+    } cluster;
+
+    /*----- 负载感知切换配置 -----*/
+    struct {
+        int enabled;        // 负载感知切换 0-关闭 1-开启
+        int wan_capacity;   // 外网带宽（Mbit/s），0=不计算带宽利用率
+        int high;           // 过载阈值（综合负载0-100）
+        int low;            // 恢复阈值，须低于high
+        int sustain;        // 越过阈值需连续持续的检测周期数
+        int hold;           // 让出后最短保持时间（秒）
+        int margin;         // 对端负载至少低于本机多少才让出
+        int shed;           // 负载分担模式下过载时移交给主路由的哈希桶数量
+    } capacity;
+
+    /*----- DHCP网关下发配置 -----*/
+    struct {
+        int steer;                      // 角色切换时通过dnsmasq下发网关 0-关闭 1-开启
+        char tag[MAX_NAME_LEN];         // dnsmasq的dhcp-range标签（OpenWrt为dhcp段名，如lan）
+        char fallback_gw[MAX_IP_LEN];   // 降级时下发的网关，为空则仍下发虚拟网关IP
+        int renew;                      // 降级时的续租时间T1（秒）
+    } dhcp;
+
     /*----- 虚拟接口配置 -----*/
     struct {
         char device[MAX_DEVICE_LEN];// 绑定物理设备
         char ipaddr[MAX_IP_LEN];    // 虚拟接口IP
         char netmask[MAX_IP_LEN];   // 子网掩码
+        int vmac;                   // 虚拟MAC模式 0-关闭 1-开启
+        int vrid;                   // 虚拟路由ID（1-255），决定虚拟MAC 00:00:5e:00:01:VRID
     } interface;
 };
 
@@ -0,0 +1,182 @@
+/**
+ * @file dhcp.c
+ * @brief DHCP网关下发模块
+ *
+ * 主要功能：
+ * 1. 角色切换时生成dnsmasq的dhcp-optsfile，下发当前可用网关
+ * 2. 网络降级期间通过T1（option 58）缩短续租时间，恢复后尽快重新下发
+ * 3. 通过SIGHUP让dnsmasq重读选项文件，无需重启服务
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/stat.h>
+#include "dhcp.h"
+
+// 已下发的状态，-1=尚未下发，0=正常，1=降级
+static int dhcp_state = -1;
+// dnsmasq实例的配置片段目录及本程序的片段路径
+static char confdir[256] = {0};
+static char fragment_path[320] = {0};
+
+/**
+ * 解析第一个dnsmasq实例的配置片段目录
+ *
+ * 优先使用uci中的confdir；否则新版init脚本使用/tmp/dnsmasq.<段名>.d，
+ * 该目录不存在时说明是旧版，使用/tmp/dnsmasq.d。
+ * 匿名段在uci show中显示为@dnsmasq[0]，需用-X取得实际段名（如cfg01411c）。
+ */
+static void resolve_confdir(void) {
+    const char *cmd =
+        "s=$(uci -q -X show dhcp | sed -n 's/^dhcp\\.\\([^.=]*\\)=dnsmasq$/\\1/p' | head -n 1); "
+        "d=$([ -n \"$s\" ] && uci -q get \"dhcp.$s.confdir\"); "
+        "[ -z \"$d\" ] && [ -n \"$s\" ] && [ -d /tmp/dnsmasq.$s.d ] && d=/tmp/dnsmasq.$s.d; "
+        "echo ${d:-" DNSMASQ_DEFAULT_CONFDIR "}";
+
+    strncpy(confdir, DNSMASQ_DEFAULT_CONFDIR, sizeof(confdir) - 1);
+    FILE *fp = popen(cmd, "r");
+    if (fp) {
+        char buf[sizeof(confdir)] = {0};
+        if (fgets(buf, sizeof(buf), fp)) {
+            buf[strcspn(buf, "\n")] = '\0';
+            if (buf[0] == '/') {
+                memcpy(confdir, buf, sizeof(confdir));
+            }
+        }
+        pclose(fp);
+    }
+    snprintf(fragment_path, sizeof(fragment_path), "%s/" DHCP_FRAGMENT_NAME, confdir);
+    syslog(LOG_INFO, "[DHCP] dnsmasq配置片段目录：%s", confdir);
+}
+
+/**
+ * 确保dnsmasq加载本程序的选项文件
+ * @return 1=片段新建（需重启dnsmasq），0=已存在，-1=失败
+ */
+static int ensure_fragment(void) {
+    const char *line = "dhcp-optsfile=" DHCP_OPTSFILE "\n";
+    char buf[128] = {0};
+
+    if (fragment_path[0] == '\0') {
+        resolve_confdir();
+    }
+
+    FILE *fp = fopen(fragment_path, "r");
+    if (fp) {
+        size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+        fclose(fp);
+        if (n == strlen(line) && strcmp(buf, line) == 0) {
+            return 0;
+        }
+    }
+
+    mkdir(confdir, 0755);
+    fp = fopen(fragment_path, "w");
+    if (!fp) {
+        syslog(LOG_ERR, "[DHCP] 写入%s失败", fragment_path);
+        return -1;
+    }
+    fputs(line, fp);
+    fclose(fp);
+
+    // 记录片段路径，供init脚本在程序异常退出后清理（confdir可能是自定义目录）
+    fp = fopen(DHCP_FRAGMENT_RECORD, "w");
+    if (fp) {
+        fprintf(fp, "%s\n", fragment_path);
+        fclose(fp);
+    }
+    return 1;
+}
+
+/**
+ * 写入DHCP选项文件（先写临时文件再重命名，避免dnsmasq读到半截内容）
+ * @return 0=成功，-1=失败
+ */
+static int write_optsfile(const struct config *cfg, const char *gateway, int degraded) {
+    const char *tmp = DHCP_OPTSFILE ".tmp";
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) {
+        syslog(LOG_ERR, "[DHCP] 写入%s失败", tmp);
+        return -1;
+    }
+
+    fprintf(fp, "tag:%s,option:router,%s\n", cfg->dhcp.tag, gateway);
+    if (degraded) {
+        fprintf(fp, "tag:%s,option:T1,%d\n", cfg->dhcp.tag, cfg->dhcp.renew);
+    }
+    fclose(fp);
+
+    if (rename(tmp, DHCP_OPTSFILE) != 0) {
+        syslog(LOG_ERR, "[DHCP] 更新%s失败", DHCP_OPTSFILE);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 启动时初始化：解析片段目录，未开启下发时清理上次运行残留的配置
+ */
+void dhcp_init(const struct config *cfg) {
+    resolve_confdir();
+    if (!cfg->dhcp.steer) {
+        dhcp_cleanup();
+    }
+}
+
+/**
+ * 删除配置片段与选项文件，使dnsmasq恢复默认网关与续租时间
+ *
+ * 片段存在时需重启dnsmasq才能去掉dhcp-optsfile；程序退出时调用，
+ * 以免dnsmasq继续下发最后一次的（可能是降级时的）网关。
+ */
+void dhcp_cleanup(void) {
+    unlink(DHCP_OPTSFILE);
+    unlink(DHCP_FRAGMENT_RECORD);
+    if (fragment_path[0] && unlink(fragment_path) == 0) {
+        syslog(LOG_INFO, "[DHCP] 已清理网关下发配置");
+        system("/etc/init.d/dnsmasq restart >/dev/null 2>&1");
+    }
+    dhcp_state = -1;
+}
+
+/**
+ * 下发当前可用网关
+ * @param cfg 配置结构体
+ * @param degraded 1=网络降级（对端/外网故障），0=正常
+ * @return 状态码（0=成功，非0=失败）
+ *
+ * 仅在状态变化时生效。正常时下发虚拟网关IP；降级时下发dhcp_fallback_gw（未配置则仍为虚拟网关IP），
+ * 并缩短续租时间，使新加入及续租的客户端始终拿到健康路径。
+ */
+int dhcp_publish_gateway(const struct config *cfg, int degraded) {
+    if (!cfg->dhcp.steer || degraded == dhcp_state) {
+        return 0;
+    }
+
+    const char *gateway = cfg->interface.ipaddr;
+    if (degraded && cfg->dhcp.fallback_gw[0]) {
+        gateway = cfg->dhcp.fallback_gw;
+    }
+
+    if (write_optsfile(cfg, gateway, degraded) != 0) {
+        return -1;
+    }
+
+    int created = ensure_fragment();
+    if (created < 0) {
+        return -1;
+    }
+    if (created) {
+        // 首次加入dhcp-optsfile需要dnsmasq重新生成配置
+        system("/etc/init.d/dnsmasq restart >/dev/null 2>&1");
+    } else {
+        system("killall -HUP dnsmasq >/dev/null 2>&1");
+    }
+
+    syslog(LOG_INFO, "[DHCP] 下发网关%s%s", gateway, degraded ? "（降级，缩短续租）" : "");
+    dhcp_state = degraded;
+    return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef DHCP_H
+#define DHCP_H
+
+#include "config.h"
+
+// 旧版OpenWrt的dnsmasq配置片段目录（新版为每个实例一个目录，如/tmp/dnsmasq.cfg01411c.d）
+#define DNSMASQ_DEFAULT_CONFDIR "/tmp/dnsmasq.d"
+// 本程序生成的配置片段文件名与选项文件
+#define DHCP_FRAGMENT_NAME "virtualgw.conf"
+#define DHCP_OPTSFILE "/tmp/virtualgw.dhcpopts"
+// 记录实际片段路径的文件，init脚本据此清理
+#define DHCP_FRAGMENT_RECORD "/var/run/virtualgw.dhcpfrag"
+
+// 降级时默认续租时间（秒）
+#define DEFAULT_DHCP_RENEW 300
+
+void dhcp_init(const struct config *cfg);
+void dhcp_cleanup(void);
+int dhcp_publish_gateway(const struct config *cfg, int degraded);
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * @file load.c
+ * @brief 本机负载采样模块
+ *
+ * 主要功能：
+ * 1. 根据/proc/stat计算CPU（含软中断）占用率
+ * 2. 根据外网设备收发字节数计算带宽利用率
+ * 3. 测量探测RTT并与基线比较，得到延迟膨胀程度
+ * 4. 按双方负载判定是否让出网关，并协商负载分担分界点
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <syslog.h>
+#include "load.h"
+#include "network.h"
+
+/**
+ * 读取CPU时间片
+ * @return 0=成功，-1=失败
+ */
+static int read_cpu(unsigned long long *total, unsigned long long *idle) {
+    unsigned long long user, nice, sys, idl, iowait, irq, softirq, steal;
+    FILE *fp = fopen("/proc/stat", "r");
+    if (!fp) {
+        return -1;
+    }
+    int n = fscanf(fp, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                   &user, &nice, &sys, &idl, &iowait, &irq, &softirq, &steal);
+    fclose(fp);
+    if (n != 8) {
+        return -1;
+    }
+    *idle = idl + iowait;
+    *total = user + nice + sys + idl + iowait + irq + softirq + steal;
+    return 0;
+}
+
+/**
+ * 读取外网设备收发字节总数
+ * @return 0=成功，-1=失败
+ */
+static int read_wan_bytes(const char *ifname, unsigned long long *bytes) {
+    const char *names[] = { "rx_bytes", "tx_bytes", NULL };
+    char path[128];
+
+    *bytes = 0;
+    for (int i = 0; names[i]; i++) {
+        unsigned long long val = 0;
+        snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s", ifname, names[i]);
+        FILE *fp = fopen(path, "r");
+        if (!fp) {
+            return -1;
+        }
+        if (fscanf(fp, "%llu", &val) != 1) {
+            fclose(fp);
+            return -1;
+        }
+        fclose(fp);
+        *bytes += val;
+    }
+    return 0;
+}
+
+/**
+ * 测量到探测目标的RTT
+ * @return RTT（微秒），-1=探测失败
+ */
+static int probe_rtt(const char *host) {
+    char cmd[MAX_IP_LEN + 32];
+    char line[256];
+    int rtt = -1;
+
+    snprintf(cmd, sizeof(cmd), "ping -c 1 -W 2 %s 2>/dev/null", host);
+    FILE *fp = popen(cmd, "r");
+    if (!fp) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        char *p = strstr(line, "time=");
+        if (p) {
+            rtt = (int)(atof(p + 5) * 1000);
+            break;
+        }
+    }
+    pclose(fp);
+    return rtt;
+}
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static int clamp_percent(long long val) {
+    return val < 0 ? 0 : (val > 100 ? 100 : (int)val);
+}
+
+/**
+ * 采样本机负载
+ * @param st 采样状态（首次调用前清零）
+ * @param cfg 配置结构体
+ * @param rtt_host RTT探测目标，NULL表示不测量
+ * @param out 输出采样结果
+ *
+ * 带宽利用率按wan_capacity（Mbit/s）折算，未配置wan_device或wan_capacity时为0；
+ * RTT膨胀以基线的两倍记为100，基线取观测到的最小RTT并缓慢上浮以适应线路变化；
+ * 膨胀按多次采样平滑后计算，低于LOAD_RTT_FLOOR_US时记为0，单次丢包重传或抖动不会推高负载。
+ */
+void load_sample(struct load_state *st, const struct config *cfg,
+                 const char *rtt_host, struct load_metrics *out) {
+    unsigned long long total = 0, idle = 0, bytes = 0;
+    long long stamp = now_ms();
+
+    memset(out, 0, sizeof(*out));
+
+    if (read_cpu(&total, &idle) == 0) {
+        if (st->cpu_total && total > st->cpu_total) {
+            unsigned long long dt = total - st->cpu_total;
+            unsigned long long di = idle - st->cpu_idle;
+            out->cpu = clamp_percent((long long)((dt - di) * 100 / dt));
+        }
+        st->cpu_total = total;
+        st->cpu_idle = idle;
+    }
+
+    if (cfg->global.wan_device[0] && cfg->capacity.wan_capacity > 0 &&
+        read_wan_bytes(cfg->global.wan_device, &bytes) == 0) {
+        // 计数器回绕或PPPoE重建时跳过本次
+        if (st->stamp_ms && bytes >= st->wan_bytes && stamp > st->stamp_ms) {
+            long long kbps = (long long)((bytes - st->wan_bytes) * 8 / (stamp - st->stamp_ms));
+            out->wan = clamp_percent(kbps * 100 / (cfg->capacity.wan_capacity * 1000LL));
+        }
+        st->wan_bytes = bytes;
+    }
+    st->stamp_ms = stamp;
+
+    if (rtt_host) {
+        int rtt = probe_rtt(rtt_host);
+        if (rtt > 0) {
+            if (st->rtt_base_us == 0 || rtt < st->rtt_base_us) {
+                st->rtt_base_us = rtt;
+            } else {
+                st->rtt_base_us += (rtt - st->rtt_base_us) / 64;
+            }
+            // 指数平滑，新样本权重1/4
+            if (st->rtt_avg_us == 0) {
+                st->rtt_avg_us = rtt;
+            } else {
+                st->rtt_avg_us += (rtt - st->rtt_avg_us) / 4;
+            }
+            int inflation = st->rtt_avg_us - st->rtt_base_us;
+            if (inflation >= LOAD_RTT_FLOOR_US) {
+                out->rtt = clamp_percent((long long)inflation * 100 / st->rtt_base_us);
+            }
+        }
+    }
+
+    out->score = out->cpu;
+    if (out->wan > out->score) out->score = out->wan;
+    if (out->rtt > out->score) out->score = out->rtt;
+
+    syslog(LOG_DEBUG, "[Load] cpu=%d%% wan=%d%% rtt=%d%% score=%d",
+           out->cpu, out->wan, out->rtt, out->score);
+}
+
+/**
+ * 负载感知切换判定（带回差）
+ * @param cs 切换状态（首次调用前清零）
+ * @param own 本机负载
+ * @param peer 对端最近的通告
+ * @return 1=应让出，0=保持
+ *
+ * 只有本机持续sustain个周期超过high、且对端负载至少低margin时才让出，并记录让出时的本机负载；
+ * 让出后本机负载必然下降，不能作为收回依据，因此只在对端持续高于让出时负载margin以上
+ * （即对端已比当初的本机更忙）或对端通告超时时收回。两个方向的切换都需距上次切换至少hold秒（对端失联除外）。
+ */
+int capacity_update(const struct config *cfg, struct capacity_state *cs,
+                    const struct load_metrics *own, const struct peer_state *peer) {
+    int peer_ok = peer_fresh(peer, cfg->global.check_interval * 3);
+    time_t now = monotonic_sec();
+    int hold_ok = !cs->since || now - cs->since >= cfg->capacity.hold;
+
+    if (!cs->shedding) {
+        if (own->score >= cfg->capacity.high && peer_ok &&
+            peer->last.load + cfg->capacity.margin <= own->score) {
+            cs->high_count++;
+        } else {
+            cs->high_count = 0;
+        }
+        if (cs->high_count >= cfg->capacity.sustain && hold_ok) {
+            syslog(LOG_NOTICE, "[Load] 持续过载（本机%d，对端%d），让出网关", own->score, peer->last.load);
+            cs->shedding = 1;
+            cs->shed_load = own->score;
+            cs->high_count = 0;
+            cs->peer_high_count = 0;
+            cs->since = now;
+        }
+    } else if (!peer_ok) {
+        syslog(LOG_NOTICE, "[Load] 对端通告超时，收回网关");
+        cs->shedding = 0;
+        cs->since = now;
+    } else {
+        // 让出时负载已接近100时以对端满载为准
+        int reclaim = cs->shed_load + cfg->capacity.margin;
+        if (reclaim > 100) reclaim = 100;
+        cs->peer_high_count = peer->last.load >= reclaim ? cs->peer_high_count + 1 : 0;
+        if (cs->peer_high_count >= cfg->capacity.sustain && hold_ok) {
+            syslog(LOG_NOTICE, "[Load] 对端持续过载（%d，让出时本机%d），收回网关",
+                   peer->last.load, cs->shed_load);
+            cs->shedding = 0;
+            cs->high_count = 0;
+            cs->since = now;
+        }
+    }
+    return cs->shedding;
+}
+
+/**
+ * 协商负载分担分界点
+ * @param side 1=旁路由（应答分界点及之后的哈希桶），0=主路由（应答分界点之前的哈希桶）
+ * @param own_req 本机请求的分界点（过载时请求对端多承担load_shed个哈希桶）
+ * @param applied 本机当前生效的分界点
+ * @param peer 对端最近的通告
+ * @return 本机应生效的分界点
+ *
+ * 目标分界点由双方请求相对lb_weight的偏移合成，两端算出的结果一致；扩大本机区间立即生效，
+ * 缩小本机区间需等对端通告已应答到目标分界点，避免中间出现无人应答的哈希桶。
+ */
+int capacity_split(const struct config *cfg, int side, int own_req, int applied,
+                   const struct peer_state *peer) {
+    if (!peer_fresh(peer, cfg->global.check_interval * 3)) {
+        return own_req;
+    }
+
+    int target = own_req;
+    if (peer->last.lb_request > 0 && peer->last.lb_request < LB_BUCKETS) {
+        target += peer->last.lb_request - cfg->global.lb_weight;
+    }
+    if (target < 1) target = 1;
+    if (target > LB_BUCKETS - 1) target = LB_BUCKETS - 1;
+
+    if (side ? target <= applied : target >= applied) {
+        return target;
+    }
+    if (side ? peer->last.lb_split >= target : peer->last.lb_split <= target) {
+        return target;
+    }
+    return applied;
+}
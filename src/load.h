@@ -0,0 +1,44 @@
+#ifndef LOAD_H
+#define LOAD_H
+
+#include "config.h"
+#include "peer.h"
+
+// RTT膨胀低于该值（微秒）时不计入负载，低基线线路上几毫秒的抖动不应触发让出
+#define LOAD_RTT_FLOOR_US 20000
+
+// 负载采样状态（保存上一次采样的计数器，用于计算差值）
+struct load_state {
+    unsigned long long cpu_total;  // /proc/stat 总时间片
+    unsigned long long cpu_idle;   // /proc/stat 空闲时间片（含iowait）
+    unsigned long long wan_bytes;  // 外网设备收发字节数
+    long long stamp_ms;            // 上次采样时间（毫秒，单调时钟）
+    int rtt_base_us;               // 基线RTT（微秒），0=尚未建立
+    int rtt_avg_us;                // 平滑后的RTT（微秒），0=尚未建立
+};
+
+// 单次采样结果，各项均为0-100
+struct load_metrics {
+    int cpu;    // CPU占用率（含软中断）
+    int wan;    // 外网带宽利用率
+    int rtt;    // 探测RTT相对基线的膨胀程度
+    int score;  // 综合负载，取以上最大值
+};
+
+// 负载感知切换状态
+struct capacity_state {
+    int shedding;        // 1=因过载已让出网关（或部分客户端）
+    int shed_load;       // 让出时本机负载，收回时与对端负载比较
+    int high_count;      // 本机连续过载周期数
+    int peer_high_count; // 对端连续过载周期数
+    time_t since;        // 上次切换时间，0=从未切换
+};
+
+void load_sample(struct load_state *st, const struct config *cfg,
+                 const char *rtt_host, struct load_metrics *out);
+int capacity_update(const struct config *cfg, struct capacity_state *cs,
+                    const struct load_metrics *own, const struct peer_state *peer);
+int capacity_split(const struct config *cfg, int side, int own_req, int applied,
+                   const struct peer_state *peer);
+
+#endif
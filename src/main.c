@@ -25,6 +25,8 @@
 #include <pthread.h>         // 线程库
 #include "master.h"
 #include "side.h"
+#include "cluster.h"
+#include "dhcp.h"
 #include <signal.h>
 #include <errno.h>
 
@@ -38,10 +40,12 @@
 // 锁文件定义
 #define LOCK_MASTER "/var/lock/gw_master.lock"
 #define LOCK_SIDE   "/var/lock/gw_side.lock"
+#define LOCK_CLUSTER "/var/lock/gw_cluster.lock"
 
 // 全局锁描述符
 static int master_lock_fd = -1;
 static int side_lock_fd = -1;
+static int cluster_lock_fd = -1;
 
 // 预清理函数
 static void cleanup_locks() {
@@ -58,11 +62,21 @@ static void cleanup_locks() {
         unlink(LOCK_SIDE);
         close(pre_fd);
     }
+
+    // 尝试清理集群锁
+    pre_fd = open(LOCK_CLUSTER, O_CREAT|O_RDWR, 0666);
+    if (pre_fd >= 0 && flock(pre_fd, LOCK_EX | LOCK_NB) == 0) {
+        unlink(LOCK_CLUSTER);
+        close(pre_fd);
+    }
 }
 
 // 信号处理
 static void sig_handler(int sig) {
     syslog(LOG_NOTICE, "[Main] 收到终止信号 %d", sig);
+
+    // 撤销DHCP网关下发
+    dhcp_cleanup();
     
     // 释放主路由锁
     if (master_lock_fd != -1) {
@@ -77,6 +91,13 @@ static void sig_handler(int sig) {
         close(side_lock_fd);
         unlink(LOCK_SIDE);
     }
+
+    // 释放集群锁
+    if (cluster_lock_fd != -1) {
+        flock(cluster_lock_fd, LOCK_UN);
+        close(cluster_lock_fd);
+        unlink(LOCK_CLUSTER);
+    }
     
     exit(EXIT_SUCCESS);
 }
@@ -145,6 +166,9 @@ int main(int argc, char *argv[]) {
         exit(EXIT_NETWORK_ERROR);
     }
     syslog(LOG_ERR, "[main] 网络接口初始化成功");
+
+    // DHCP网关下发初始化
+    dhcp_init(&cfg);
     
     // 注册信号处理
     signal(SIGTERM, sig_handler);
@@ -156,8 +180,9 @@ int main(int argc, char *argv[]) {
     
     // 根据角色获取对应锁
     int is_master = (strcmp(cfg.global.state, "master") == 0);
-    const char *lock_file = is_master ? LOCK_MASTER : LOCK_SIDE;
-    int *lock_fd = is_master ? &master_lock_fd : &side_lock_fd;
+    int is_cluster = (strcmp(cfg.global.state, "cluster") == 0);
+    const char *lock_file = is_cluster ? LOCK_CLUSTER : (is_master ? LOCK_MASTER : LOCK_SIDE);
+    int *lock_fd = is_cluster ? &cluster_lock_fd : (is_master ? &master_lock_fd : &side_lock_fd);
     
     // 获取角色专属锁
     *lock_fd = open(lock_file, O_CREAT|O_RDWR, 0666);
@@ -167,7 +192,14 @@ int main(int argc, char *argv[]) {
     }
 
     // 修改关闭逻辑
-    if (is_master) { 
+    if (is_cluster) {
+        syslog(LOG_ERR, "[main] 当前设备为集群节点");
+        // 初始化失败时退出，由procd重新拉起，而不是持有锁空转
+        if (cluster_loop(&cfg) != 0) {
+            exit(EXIT_NETWORK_ERROR);
+        }
+    }
+    else if (is_master) { 
         syslog(LOG_ERR, "[main] 当前设备为主路由");
         master_loop(&cfg);
     }
@@ -15,10 +15,14 @@
 #include <fcntl.h>   // 解决O_CREAT错误
 #include <unistd.h>  // 解决close函数声明
 #include <stdlib.h>    // for system()
+#include "load.h"
+#include "peer.h"
+#include "dhcp.h"
+#include "status.h"
 
 
 int detect_lan_peer(const char *peer_ip) {
-    char cmd[128];
+    char cmd[MAX_IP_LEN + 64];
     int success_count = 0;
     int total_attempts = 3;
     
@@ -40,18 +44,71 @@ int detect_lan_peer(const char *peer_ip) {
  */
 void* master_loop(struct config *cfg) {
     syslog(LOG_INFO, "[Master] 主路由服务已启动");
+    // 负载感知切换：与旁路由交换负载通告
+    int peer_fd = cfg->capacity.enabled ? peer_open(cfg->global.advert_port) : -1;
+    struct load_state load_st = {0};
+    struct peer_state peer = {0};
+    struct capacity_state cap = {0};
+    int applied = LB_BUCKETS;   // 本机实际应答到的分界点（之前的哈希桶），LB_BUCKETS=全部
     while(1) {
         /* 旁路由连通性检测 */
         int peer_online = detect_lan_peer(cfg->global.detect_src_addr);
+        int split = cfg->global.lb_weight;
+        int request = cfg->global.lb_weight;
+        int yield_req = 0;
+        struct load_metrics own = {0};
+
+        if (peer_fd >= 0) {
+            load_sample(&load_st, cfg, NULL, &own);
+            // 旁路由过载时会请求后移分界点或请求接管，主路由随之多承担客户端
+            peer_poll(peer_fd, cfg->global.detect_src_addr, &peer);
+            if (peer_fresh(&peer, cfg->global.check_interval * 3)) {
+                yield_req = peer.last.flags & ADVERT_F_YIELD;
+            }
+            // 负载分担时本机过载同样可请求前移分界点，把部分客户端交给旁路由；
+            // 主备模式下主路由只在旁路由让出后才持有网关，由旁路由按让出时的负载判断收回
+            if (cfg->global.loadshare) {
+                if (peer_online == 0 && capacity_update(cfg, &cap, &own, &peer)) {
+                    request -= cfg->capacity.shed;
+                    if (request < 1) request = 1;
+                }
+                split = capacity_split(cfg, 0, request, applied, &peer);
+            }
+        }
         
+        // 旁路由离线即为降级，向新加入及续租的客户端下发当前网关
+        dhcp_publish_gateway(cfg, peer_online != 0);
+
         // 仅当旁路由在线时查询其外网状态
-        if (peer_online == 0) { 
+        if (peer_online == 0 && cfg->global.loadshare) {
+            // 负载分担：双方同时持有虚拟IP，主路由应答分界点之前的哈希桶
+            syslog(LOG_INFO, "[Master] 旁路由在线，负载分担");
+            // 规则下发失败时应答全部哈希桶，与旁路由重叠但不会让任何客户端失去网关
+            applied = apply_loadshare(cfg, 0, split - 1, 1) == 0 ? split : LB_BUCKETS;
+        }
+        else if (peer_online == 0 && !yield_req) { 
             syslog(LOG_INFO, "[Master] 旁路由在线");
             disable_network_interface("virtual_gw");
         }
         else {
-            syslog(LOG_INFO, "[Master] 旁路由离线");
-            enable_network_interface("virtual_gw");
+            syslog(LOG_INFO, yield_req && peer_online == 0 ? "[Master] 旁路由请求接管" : "[Master] 旁路由离线");
+            if (cfg->global.loadshare) {
+                apply_loadshare(cfg, 0, LB_BUCKETS - 1, 1);
+                applied = LB_BUCKETS;
+            } else {
+                enable_network_interface("virtual_gw");
+            }
+        }
+
+        // 接管后再通告，旁路由据持有标志确认后才释放网关；lb_split为本机实际生效的分界点
+        if (peer_fd >= 0) {
+            struct gw_advert adv = {
+                .load = own.score,
+                .lb_split = applied,
+                .lb_request = request,
+                .flags = gw_status == 0 ? ADVERT_F_OWNER : 0,
+            };
+            peer_send(peer_fd, cfg->global.detect_src_addr, cfg->global.advert_port, &adv);
         }
         sleep(cfg->global.check_interval); // 等待下一个检测周期
     }
@@ -4,4 +4,5 @@
 #include "config.h"
 
 void master_loop(struct config *cfg);
+int detect_lan_peer(const char *peer_ip);
 #endif 
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include <uci.h>
 #include <sys/wait.h>
 #include <syslog.h>
@@ -9,7 +10,221 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>    // for sleep()
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <net/ethernet.h>
+#include <netpacket/packet.h>
 #include "status.h"
+#include "network.h"
+
+// 虚拟MAC模式下的macvlan设备名
+static char vmac_ifname[MAX_DEVICE_LEN] = {0};
+// 接口启用后发送免费ARP的设备与虚拟IP，为空则不发送
+static char announce_ifname[MAX_DEVICE_LEN] = {0};
+static char announce_ipaddr[MAX_IP_LEN] = {0};
+
+// 负载分担当前应答的哈希桶区间，-1=未设置
+static int lb_low = -1;
+static int lb_high = -1;
+
+/**
+ * 设置设备的ARP内核参数，首次修改时保存原值以便恢复
+ * @param dev 设备名（可含点号，如eth0.1）
+ * @param name 参数名（arp_ignore/arp_announce）
+ * @param value 新值
+ *
+ * 直接写/proc/sys，sysctl会把设备名中的点号当作层级分隔符。
+ */
+static void set_arp_param(const char *dev, const char *name, int value) {
+    char path[128], saved[128];
+    int orig;
+
+    snprintf(path, sizeof(path), "/proc/sys/net/ipv4/conf/%s/%s", dev, name);
+    snprintf(saved, sizeof(saved), ARP_SAVE_DIR "/virtualgw.%s.%s", dev, name);
+
+    // 保存文件已存在说明之前由本程序修改过，其中才是原值
+    if (access(saved, F_OK) != 0) {
+        FILE *fp = fopen(path, "r");
+        if (!fp || fscanf(fp, "%d", &orig) != 1) {
+            syslog(LOG_ERR, "[Network] 读取%s失败", path);
+            if (fp) fclose(fp);
+            return;
+        }
+        fclose(fp);
+        fp = fopen(saved, "w");
+        if (fp) {
+            fprintf(fp, "%d\n", orig);
+            fclose(fp);
+        }
+    }
+
+    FILE *fp = fopen(path, "w");
+    if (!fp || fprintf(fp, "%d\n", value) < 0) {
+        syslog(LOG_ERR, "[Network] 写入%s失败", path);
+    }
+    if (fp) fclose(fp);
+}
+
+/**
+ * 恢复set_arp_param修改前的ARP内核参数
+ */
+static void restore_arp_param(const char *dev, const char *name) {
+    char path[128], saved[128];
+    int orig;
+
+    snprintf(saved, sizeof(saved), ARP_SAVE_DIR "/virtualgw.%s.%s", dev, name);
+    FILE *fp = fopen(saved, "r");
+    if (!fp) {
+        return;
+    }
+    int ok = fscanf(fp, "%d", &orig) == 1;
+    fclose(fp);
+
+    if (ok) {
+        snprintf(path, sizeof(path), "/proc/sys/net/ipv4/conf/%s/%s", dev, name);
+        fp = fopen(path, "w");
+        if (fp) {
+            fprintf(fp, "%d\n", orig);
+            fclose(fp);
+        }
+    }
+    unlink(saved);
+}
+
+/**
+ * 配置虚拟MAC模式使用的macvlan设备
+ * @param cfg 配置结构体
+ * @param ifname 输出macvlan设备名（长度MAX_DEVICE_LEN）
+ * @return 状态码（0=成功，非0=失败）
+ *
+ * 在物理设备上创建使用VRRP虚拟MAC（00:00:5e:00:01:VRID）的macvlan，
+ * virtual_gw接口绑定到该设备，接口up/down即由当前活动路由器带起/释放虚拟MAC，
+ * 客户端看到的网关IP与MAC在切换前后保持不变。
+ */
+static int configure_vmac_device(const struct config *cfg, char *ifname) {
+    char cmd[1024];
+
+    snprintf(ifname, MAX_DEVICE_LEN, "vgw%d", cfg->interface.vrid);
+    snprintf(cmd, sizeof(cmd),
+             "uci -q batch <<-EOF >/dev/null 2>&1\n"
+             "set network.virtual_gw_vmac=device\n"
+             "set network.virtual_gw_vmac.type=macvlan\n"
+             "set network.virtual_gw_vmac.ifname=%s\n"
+             "set network.virtual_gw_vmac.mode=private\n"
+             "set network.virtual_gw_vmac.name=%s\n"
+             "set network.virtual_gw_vmac.macaddr=00:00:5e:00:01:%02x\n"
+             "commit network\n"
+             "EOF",
+             cfg->interface.device, ifname, cfg->interface.vrid);
+    if (system(cmd) != 0) {
+        syslog(LOG_ERR, "[Network] macvlan设备配置失败");
+        return -1;
+    }
+
+    syslog(LOG_INFO, "[Network] 虚拟MAC设备%s已配置（VRID=%d）", ifname, cfg->interface.vrid);
+    return 0;
+}
+
+/**
+ * 发送免费ARP，使交换机与客户端立即刷新虚拟IP对应的端口与MAC
+ * @param ifname 发送设备（其MAC即为通告的MAC）
+ * @param ipaddr 虚拟IP
+ * @return 状态码（0=成功，-1=失败）
+ *
+ * 直接使用packet套接字构造ARP请求（发送方与目标IP均为虚拟IP），不依赖arping。
+ */
+int send_gratuitous_arp(const char *ifname, const char *ipaddr) {
+    struct {
+        struct arphdr hdr;
+        unsigned char sha[ETH_ALEN];
+        unsigned char spa[4];
+        unsigned char tha[ETH_ALEN];
+        unsigned char tpa[4];
+    } __attribute__((packed)) pkt;
+    struct sockaddr_ll dst;
+    struct ifreq ifr;
+    struct in_addr ip;
+    int ret = -1;
+
+    if (inet_pton(AF_INET, ipaddr, &ip) != 1) {
+        return -1;
+    }
+    int fd = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_ARP));
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
+        goto out;
+    }
+
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.hdr.ar_hrd = htons(ARPHRD_ETHER);
+    pkt.hdr.ar_pro = htons(ETH_P_IP);
+    pkt.hdr.ar_hln = ETH_ALEN;
+    pkt.hdr.ar_pln = 4;
+    pkt.hdr.ar_op = htons(ARPOP_REQUEST);
+    memcpy(pkt.sha, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+    memcpy(pkt.spa, &ip, 4);
+    memcpy(pkt.tpa, &ip, 4);
+
+    memset(&dst, 0, sizeof(dst));
+    dst.sll_family = AF_PACKET;
+    dst.sll_protocol = htons(ETH_P_ARP);
+    dst.sll_ifindex = if_nametoindex(ifname);
+    dst.sll_halen = ETH_ALEN;
+    memset(dst.sll_addr, 0xff, ETH_ALEN);
+    if (dst.sll_ifindex == 0) {
+        goto out;
+    }
+
+    if (sendto(fd, &pkt, sizeof(pkt), 0, (struct sockaddr *)&dst, sizeof(dst)) == sizeof(pkt)) {
+        ret = 0;
+    }
+out:
+    close(fd);
+    return ret;
+}
+
+/**
+ * 接口启用后通告虚拟IP当前所在的MAC，使切换后的客户端立即改投本机
+ */
+static void announce_gateway(void) {
+    if (announce_ifname[0] == '\0') {
+        return;
+    }
+    if (send_gratuitous_arp(announce_ifname, announce_ipaddr) != 0) {
+        syslog(LOG_ERR, "[Network] %s 免费ARP发送失败", announce_ifname);
+    }
+}
+
+/**
+ * 将virtual_gw加入/移出lan防火墙区域
+ * @param add 1=加入，0=移出
+ *
+ * 虚拟MAC模式下客户端流量从macvlan设备进入，不再属于br-lan，
+ * 需将virtual_gw接口加入lan区域，否则转发流量会落入默认策略被拒绝。
+ */
+static void set_lan_zone_member(int add) {
+    char cmd[512];
+
+    snprintf(cmd, sizeof(cmd),
+             "z=$(uci -q show firewall | sed -n \"s/^\\(firewall\\.[^.]*\\)\\.name='lan'$/\\1/p\" | head -n 1); "
+             "[ -n \"$z\" ] || exit 1; "
+             "uci -q get $z.network | grep -qw virtual_gw; in_zone=$?; "
+             "[ %d -eq 1 ] && [ $in_zone -ne 0 ] && uci add_list $z.network=virtual_gw && changed=1; "
+             "[ %d -eq 0 ] && [ $in_zone -eq 0 ] && uci del_list $z.network=virtual_gw && changed=1; "
+             "[ -n \"$changed\" ] && uci commit firewall && /etc/init.d/firewall reload; "
+             "exit 0",
+             add, add);
+    if (system(cmd) != 0) {
+        syslog(LOG_ERR, "[Network] 未找到lan防火墙区域，无法调整virtual_gw所属区域");
+    }
+}
+
 /**
  * 配置虚拟网关网络接口
  * @return 状态码（0=成功，负数=错误码）
@@ -32,6 +247,43 @@ int configure_network_interface(const struct config *cfg) {
     struct uci_context *ctx = uci_alloc_context(); // UCI配置上下文
     struct uci_package *pkg = NULL;                // network配置包指针
     int ret = 0;                                   // 返回值初始化
+    const char *device = cfg->interface.device;    // 接口绑定设备
+
+    // 虚拟MAC模式：接口改为绑定macvlan设备，否则清理残留的macvlan设备段
+    if (cfg->interface.vmac) {
+        if (configure_vmac_device(cfg, vmac_ifname) != 0) {
+            return -3;
+        }
+        device = vmac_ifname;
+        set_lan_zone_member(1);
+    } else {
+        system("uci -q delete network.virtual_gw_vmac >/dev/null 2>&1 && uci commit network");
+        set_lan_zone_member(0);
+    }
+
+    // 负载分担时由set_loadshare_range在接管全部客户端时通告，部分区间时不能通告，否则会抢走对端的客户端
+    if (!cfg->global.loadshare) {
+        snprintf(announce_ifname, sizeof(announce_ifname), "%s", device);
+        snprintf(announce_ipaddr, sizeof(announce_ipaddr), "%s", cfg->interface.ipaddr);
+    }
+
+    // 未开启负载分担时清除残留的ARP分流规则，否则部分客户端仍会收不到虚拟IP的ARP应答
+    if (!cfg->global.loadshare) {
+        system("nft delete table arp virtualgw >/dev/null 2>&1");
+    }
+
+    // 虚拟MAC模式：物理设备不再应答虚拟IP的ARP，避免与虚拟MAC争抢
+    if (cfg->interface.vmac) {
+        set_arp_param(cfg->interface.device, "arp_ignore", 1);
+    } else {
+        restore_arp_param(cfg->interface.device, "arp_ignore");
+    }
+    // 虚拟MAC与负载分担模式：主动ARP请求改用本机地址，避免客户端被虚拟IP的请求改写缓存
+    if (cfg->interface.vmac || cfg->global.loadshare) {
+        set_arp_param(cfg->interface.device, "arp_announce", 2);
+    } else {
+        restore_arp_param(cfg->interface.device, "arp_announce");
+    }
 
     // 加载network配置（路径为/etc/config/network）
     if (uci_load(ctx, "network", &pkg) != UCI_OK) {
@@ -73,7 +325,7 @@ int configure_network_interface(const struct config *cfg) {
      * 包含协议类型、设备名称、IP地址等关键参数
      */
     const char *options[] = {
-        "device",   cfg->interface.device,       // 绑定物理网卡
+        "device",   device,       // 绑定物理网卡或虚拟MAC设备
         "proto",    "static",     // 使用静态IP协议
         "ipaddr",   cfg->interface.ipaddr, // 虚拟网关IP
         "netmask",  cfg->interface.netmask, // 子网掩码
@@ -137,6 +389,7 @@ int enable_network_interface(const char *ifname) {
         }
         syslog(LOG_ERR, "[Network] 接口启动成功");
         gw_status = 0;
+        announce_gateway();
     }
     return 0;
 }
@@ -214,8 +467,92 @@ int enable_ping_response() {
     return 0;
 }
 
+/**
+ * 设置负载分担的ARP应答区间
+ * @param cfg 配置结构体
+ * @param low 本机负责的哈希桶下限（0-99）
+ * @param high 本机负责的哈希桶上限（0-99），low=0且high=99表示接管全部客户端
+ * @return 状态码（0=成功，非0=失败）
+ *
+ * 以客户端IP的jhash（固定种子，主/旁路由结果一致）分成100个桶，
+ * 只应答落在本机区间内的虚拟IP ARP请求，其余请求丢弃交给对端应答。
+ */
+int set_loadshare_range(const struct config *cfg, int low, int high) {
+    char cmd[512];
+    char vip[INET_ADDRSTRLEN];
+    struct in_addr addr;
 
+    if (low == lb_low && high == lb_high) {
+        return 0;
+    }
 
+    if (low > 0 || high < LB_BUCKETS - 1) {
+        // 由地址重新格式化，命令长度有确定上限
+        if (inet_pton(AF_INET, cfg->interface.ipaddr, &addr) != 1) {
+            syslog(LOG_ERR, "[Network] 虚拟网关地址%s无效", cfg->interface.ipaddr);
+            return -1;
+        }
+        inet_ntop(AF_INET, &addr, vip, sizeof(vip));
+        // 先建后删在同一事务中完成，规则替换期间不会出现两台路由同时应答的窗口；失败时旧规则保持不变
+        snprintf(cmd, sizeof(cmd),
+                 "nft -f - <<-EOF >/dev/null 2>&1\n"
+                 "table arp virtualgw\n"
+                 "delete table arp virtualgw\n"
+                 "table arp virtualgw {\n"
+                 "chain input {\n"
+                 "type filter hook input priority 0; policy accept;\n"
+                 "arp operation request arp daddr ip %s jhash arp saddr ip mod %d seed 0x%x != %d-%d drop\n"
+                 "}\n"
+                 "}\n"
+                 "EOF",
+                 vip, LB_BUCKETS, LB_HASH_SEED, low, high);
+        if (system(cmd) != 0) {
+            syslog(LOG_ERR, "[Network] 负载分担规则设置失败");
+            return -1;
+        }
+        syslog(LOG_INFO, "[Network] 负载分担：应答哈希桶%d-%d", low, high);
+    } else {
+        system("nft delete table arp virtualgw >/dev/null 2>&1");
+        // 缓存了对端MAC的客户端需立即改写，否则要等ARP表项过期才会切换过来
+        if (send_gratuitous_arp(cfg->interface.device, cfg->interface.ipaddr) != 0) {
+            syslog(LOG_ERR, "[Network] %s 免费ARP发送失败", cfg->interface.device);
+        }
+        syslog(LOG_INFO, "[Network] 负载分担：接管全部客户端");
+    }
 
+    lb_low = low;
+    lb_high = high;
+    return 0;
+}
 
-   
\ No newline at end of file
+/**
+ * 按负载分担区间持有虚拟网关
+ * @param cfg 配置结构体
+ * @param low 本机负责的哈希桶下限
+ * @param high 本机负责的哈希桶上限
+ * @param fail_open 规则下发失败时：1=撤销规则应答全部ARP请求（主路由），0=释放接口（旁路由）
+ * @return 状态码（0=成功，非0=失败）
+ *
+ * 部分区间时先下发ARP规则再启用接口；接管全部客户端时先启用接口再撤销规则并发送免费ARP。
+ * 旁路由规则失败时释放接口并停止响应ping，由主路由接管全部客户端；主路由此时不能释放，
+ * 否则本机区间的客户端没有网关，宁可与旁路由重叠应答。
+ */
+int apply_loadshare(const struct config *cfg, int low, int high, int fail_open) {
+    if (low == 0 && high == LB_BUCKETS - 1) {
+        enable_network_interface("virtual_gw");
+        return set_loadshare_range(cfg, low, high);
+    }
+    if (set_loadshare_range(cfg, low, high) != 0) {
+        if (fail_open) {
+            // 不发送免费ARP，只应答请求，客户端不会被整体抢到本机
+            system("nft delete table arp virtualgw >/dev/null 2>&1");
+            lb_low = -1;
+            lb_high = -1;
+            enable_network_interface("virtual_gw");
+        } else {
+            disable_network_interface("virtual_gw");
+        }
+        return -1;
+    }
+    return enable_network_interface("virtual_gw");
+}
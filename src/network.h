@@ -1,8 +1,19 @@
 #include "config.h"
+
+// 负载分担哈希桶数量与固定哈希种子（主/旁路由必须一致）
+#define LB_BUCKETS 100
+#define LB_HASH_SEED 0x56475721
+
+// 保存被修改的ARP内核参数原值的目录（需跨进程重启保留，重启系统后参数本身也会复位）
+#define ARP_SAVE_DIR "/var/run"
+
 int configure_network_interface(const struct config *cfg);
 int enable_network_interface(const char *ifname);
 int disable_network_interface(const char *ifname);
 int enable_ping_response();
 int disable_ping_response();
+int send_gratuitous_arp(const char *ifname, const char *ipaddr);
+int set_loadshare_range(const struct config *cfg, int low, int high);
+int apply_loadshare(const struct config *cfg, int low, int high, int fail_open);
 
 
@@ -0,0 +1,139 @@
+/**
+ * @file peer.c
+ * @brief 对端状态通告模块
+ *
+ * 主要功能：
+ * 1. 通过UDP向对端发送本机负载等状态
+ * 2. 非阻塞接收对端通告，记录最新内容与时间
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "peer.h"
+
+/**
+ * 单调时钟秒数，不受NTP校时影响（无RTC的设备启动后时间会跳变数十年）
+ */
+time_t monotonic_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/**
+ * 创建通告套接字
+ * @param port 监听端口
+ * @return 套接字描述符，-1=失败
+ */
+int peer_open(int port) {
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        syslog(LOG_ERR, "[Peer] 创建通告套接字失败");
+        return -1;
+    }
+
+    // 集群模式向子网广播地址发送通告
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        syslog(LOG_ERR, "[Peer] 绑定通告端口%d失败", port);
+        close(fd);
+        return -1;
+    }
+
+    syslog(LOG_INFO, "[Peer] 通告端口%d已打开", port);
+    return fd;
+}
+
+/**
+ * 向对端发送通告
+ * @param addr 对端IPv4地址
+ * @return 0=成功，-1=失败
+ */
+int peer_send(int fd, const char *addr, int port, const struct gw_advert *adv) {
+    struct sockaddr_in dst;
+    struct gw_advert pkt = *adv;
+
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(port);
+    if (inet_pton(AF_INET, addr, &dst.sin_addr) != 1) {
+        syslog(LOG_ERR, "[Peer] 对端地址%s无效", addr);
+        return -1;
+    }
+
+    pkt.magic = htonl(ADVERT_MAGIC);
+    pkt.version = ADVERT_VERSION;
+    if (sendto(fd, &pkt, sizeof(pkt), 0, (struct sockaddr *)&dst, sizeof(dst)) != sizeof(pkt)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 读取一条有效通告
+ * @param from 输出发送方地址
+ * @return 1=收到，0=无待处理通告
+ */
+int peer_recv(int fd, struct gw_advert *adv, struct in_addr *from) {
+    struct sockaddr_in src;
+
+    while (1) {
+        socklen_t slen = sizeof(src);
+        ssize_t len = recvfrom(fd, adv, sizeof(*adv), 0, (struct sockaddr *)&src, &slen);
+        if (len < 0) {
+            return 0;
+        }
+        if (len == sizeof(*adv) && ntohl(adv->magic) == ADVERT_MAGIC &&
+            adv->version == ADVERT_VERSION) {
+            *from = src.sin_addr;
+            return 1;
+        }
+    }
+}
+
+/**
+ * 读取所有待处理的对端通告，只保留最新一条
+ * @param addr 对端IPv4地址，其他来源的报文被丢弃
+ * @return 1=收到新通告，0=无新通告
+ */
+int peer_poll(int fd, const char *addr, struct peer_state *ps) {
+    struct gw_advert pkt;
+    struct in_addr from, expect;
+    int updated = 0;
+
+    if (inet_pton(AF_INET, addr, &expect) != 1) {
+        return 0;
+    }
+
+    while (peer_recv(fd, &pkt, &from)) {
+        if (from.s_addr != expect.s_addr) {
+            continue;
+        }
+        ps->last = pkt;
+        ps->seen = monotonic_sec();
+        updated = 1;
+    }
+    return updated;
+}
+
+/**
+ * 判断对端通告是否仍然有效
+ * @param timeout 超时时间（秒）
+ * @return 1=有效，0=超时或从未收到
+ */
+int peer_fresh(const struct peer_state *ps, int timeout) {
+    return ps->seen != 0 && monotonic_sec() - ps->seen <= timeout;
+}
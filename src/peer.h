@@ -0,0 +1,48 @@
+#ifndef PEER_H
+#define PEER_H
+
+#include <stdint.h>
+#include <time.h>
+#include <netinet/in.h>
+
+// 通告报文标识 "VGW1" 与版本
+#define ADVERT_MAGIC 0x56475731
+#define ADVERT_VERSION 3
+
+// 通告标志位
+#define ADVERT_F_OWNER   0x01   // 发送方持有虚拟网关
+#define ADVERT_F_HEALTHY 0x02   // 发送方外网检测正常
+#define ADVERT_F_YIELD   0x04   // 旁路由因过载请求主路由接管网关
+
+// 默认通告端口
+#define DEFAULT_ADVERT_PORT 17899
+
+/**
+ * 主/旁路由之间交换的状态通告（网络字节序）
+ */
+struct gw_advert {
+    uint32_t magic;     // ADVERT_MAGIC
+    uint8_t version;    // ADVERT_VERSION
+    uint8_t load;       // 综合负载0-100
+    uint8_t lb_split;   // 负载分担分界点（发送方已生效值）
+    uint8_t priority;   // 集群优先级
+    uint8_t flags;      // ADVERT_F_*
+    uint8_t lb_request; // 负载分担分界点（发送方请求值，过载时请求对端多承担）
+    uint8_t reserved[2];
+    uint32_t node;      // 集群节点标识（发送方LAN地址）
+} __attribute__((packed));
+
+// 最近一次收到的对端通告
+struct peer_state {
+    struct gw_advert last;  // 通告内容
+    time_t seen;            // 接收时间（单调时钟秒），0=从未收到
+};
+
+int peer_open(int port);
+int peer_send(int fd, const char *addr, int port, const struct gw_advert *adv);
+int peer_recv(int fd, struct gw_advert *adv, struct in_addr *from);
+int peer_poll(int fd, const char *addr, struct peer_state *ps);
+int peer_fresh(const struct peer_state *ps, int timeout);
+time_t monotonic_sec(void);
+
+#endif
@@ -14,18 +14,32 @@
 #include <arpa/inet.h>
 #include "config.h"
 #include "network.h"
+#include "master.h"
+#include "wanmon.h"
+#include "load.h"
+#include "peer.h"
+#include "dhcp.h"
 #include <stdlib.h>
 
 /**
- * 检测外网连通性 - 改进版
+ * 检测外网连通性，两次ping之间监听外网口事件
  * @param detect_host 外网检测目标
+ * @param wan_fd wanmon_open返回的套接字，-1表示不监听
+ * @param ifname 外网设备名
+ * @param event 输出检测期间收到的外网口事件（WANMON_*），可为NULL
  * @return 0=可达，1=不可达
+ *
+ * 一轮检测最长约7.5秒，期间载波丢失等明确故障立即判定为不可达，不再等剩余的ping；
+ * 检测期间的事件已被读走，调用方需据event决定是否立即重新检测。
  */
-int detect_wan_connectivity(const char *detect_host) {
-    char cmd[128];
+int detect_wan_watch(const char *detect_host, int wan_fd, const char *ifname, int *event) {
+    char cmd[MAX_IP_LEN + 64];
     int success_count = 0;
     int total_attempts = 3;  // 增加检测次数
-    
+
+    if (event) {
+        *event = WANMON_TIMEOUT;
+    }
     for (int i = 0; i < total_attempts; i++) {
         // 构建ping命令，指定超时和目标地址
         snprintf(cmd, sizeof(cmd), "ping -c 1 -W 2 %s >/dev/null 2>&1", detect_host);
@@ -36,30 +50,147 @@ int detect_wan_connectivity(const char *detect_host) {
             success_count++;
         }
         
-        // 短暂等待避免连续ping造成拥塞
-        usleep(500000);  // 0.5秒
+        // 短暂等待避免连续ping造成拥塞，等待期间处理外网口事件
+        if (wan_fd < 0) {
+            usleep(500000);  // 0.5秒
+            continue;
+        }
+        int ev = wanmon_wait(wan_fd, ifname, 500);
+        if (ev == WANMON_DOWN) {
+            if (event) {
+                *event = WANMON_DOWN;
+            }
+            return 1;
+        }
+        if (ev == WANMON_REPROBE && event) {
+            *event = WANMON_REPROBE;
+        }
     }
     
     // 采用多数原则 - 至少有2次成功则认为连通
     return (success_count >= 2) ? 0 : 1;
 }
 
+/**
+ * 检测外网连通性 - 改进版
+ * @param detect_host 外网检测目标
+ * @return 0=可达，1=不可达
+ */
+int detect_wan_connectivity(const char *detect_host) {
+    return detect_wan_watch(detect_host, -1, NULL, NULL);
+}
+
+/**
+ * 外网不通时释放虚拟网关
+ */
+static void side_release(void) {
+    disable_network_interface("virtual_gw");
+    disable_ping_response();
+}
+
 void* side_loop(struct config *cfg) {
     syslog(LOG_INFO, "[Side] 旁路由服务已启动");
+    // 配置了外网设备时监听内核事件，失败则退回固定间隔检测
+    int wan_fd = cfg->global.wan_device[0] ? wanmon_open() : -1;
+    // 负载感知切换：与主路由交换负载通告
+    int peer_fd = cfg->capacity.enabled ? peer_open(cfg->global.advert_port) : -1;
+    struct load_state load_st = {0};
+    struct peer_state peer = {0};
+    struct capacity_state cap = {0};
+    struct load_metrics own = {0};
+    int applied = cfg->global.lb_weight;    // 本机实际应答的起始哈希桶，LB_BUCKETS=不应答
     while(1) {
         syslog(LOG_INFO, "[Side] 网络监测...");
         /* 外网检测逻辑 */
-        int wan_status = detect_wan_connectivity(cfg->global.detect_src_addr);
-        if (wan_status == 0) {
+        int wan_event = WANMON_TIMEOUT;
+        int wan_status = detect_wan_watch(cfg->global.detect_src_addr, wan_fd,
+                                          cfg->global.wan_device, &wan_event);
+        if (wan_event == WANMON_DOWN) {
+            // 直接按外网不通处理，不会先启用网关再释放
+            syslog(LOG_INFO, "[Side] 检测期间外网口故障");
+        }
+        int shedding = 0;
+        int peer_owner = 0;      // 主路由已确认持有网关
+        int split = cfg->global.lb_weight;
+        int request = cfg->global.lb_weight;
+        if (peer_fd >= 0) {
+            load_sample(&load_st, cfg, cfg->global.detect_src_addr, &own);
+            peer_poll(peer_fd, cfg->global.peer_addr, &peer);
+            int peer_ok = peer_fresh(&peer, cfg->global.check_interval * 3);
+            shedding = wan_status == 0 && capacity_update(cfg, &cap, &own, &peer);
+            peer_owner = peer_ok && (peer.last.flags & ADVERT_F_OWNER);
+            if (cfg->global.loadshare) {
+                // 本机过载时请求后移分界点；主路由过载时它会请求前移，由双方请求合成
+                if (shedding) {
+                    request += cfg->capacity.shed;
+                    if (request > LB_BUCKETS - 1) request = LB_BUCKETS - 1;
+                }
+                split = capacity_split(cfg, 1, request, applied, &peer);
+            }
+        }
+
+        // 外网不通即为降级（旁路由自身运行DHCP服务时生效）
+        dhcp_publish_gateway(cfg, wan_status != 0);
+
+        if (wan_status == 0 && shedding && !cfg->global.loadshare && peer_owner) {
+            // 主路由已确认接管，此时再释放不会出现无人持有网关的间隙
+            syslog(LOG_INFO, "[Side] 外网通畅，主路由已接管，因过载让出网关");
+            side_release();
+        } else if (wan_status == 0 && shedding && !cfg->global.loadshare) {
+            syslog(LOG_INFO, "[Side] 外网通畅，已请求主路由接管");
+            enable_network_interface("virtual_gw");
+            enable_ping_response();
+        } else if (wan_status == 0 && cfg->global.loadshare) {
+            syslog(LOG_INFO, "[Side] 外网通畅，负载分担");
+            // 主路由在线时只应答split之后的哈希桶（过载时后移），离线时接管全部客户端
+            int low = split;
+            if (detect_lan_peer(cfg->global.peer_addr) != 0) {
+                syslog(LOG_INFO, "[Side] 主路由离线，接管全部客户端");
+                low = 0;
+            }
+            if (apply_loadshare(cfg, low, LB_BUCKETS - 1, 0) == 0) {
+                enable_ping_response();
+                applied = low;
+            } else {
+                // 分流规则未生效，停止响应ping让主路由接管全部客户端
+                side_release();
+                applied = LB_BUCKETS;
+            }
+        } else if (wan_status == 0) {
             syslog(LOG_INFO, "[Side] 外网通畅");
             enable_network_interface("virtual_gw");
             enable_ping_response();
         } else {
             syslog(LOG_INFO, "[Side] 外网不通");
-            disable_network_interface("virtual_gw");
-            disable_ping_response();
+            side_release();
+            applied = LB_BUCKETS;
+        }
+
+        // 应用后再通告，lb_split为本机实际生效的分界点，主路由据此确认后才收缩
+        if (peer_fd >= 0) {
+            struct gw_advert adv = {
+                .load = own.score,
+                .lb_split = applied,
+                .lb_request = request,
+                .flags = shedding && !cfg->global.loadshare ? ADVERT_F_YIELD : 0,
+            };
+            peer_send(peer_fd, cfg->global.peer_addr, cfg->global.advert_port, &adv);
+        }
+
+        if (wan_fd < 0) {
+            sleep(cfg->global.check_interval);
+            continue;
+        }
+        // 检测期间已有链路/路由/地址变化，本轮结果可能已过时，立即重新检测
+        if (wan_event == WANMON_REPROBE) {
+            continue;
+        }
+        // 载波丢失等明确故障无需再ping确认，立即释放；其余事件直接进入下一轮检测
+        if (wanmon_wait(wan_fd, cfg->global.wan_device, cfg->global.check_interval * 1000L) == WANMON_DOWN) {
+            syslog(LOG_INFO, "[Side] 外网口故障，立即释放网关");
+            side_release();
+            applied = LB_BUCKETS;
         }
-        sleep(cfg->global.check_interval);
     }
     return NULL;
 }
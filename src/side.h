@@ -4,5 +4,7 @@
 #include "config.h"
 
 void side_loop(struct config *cfg);
+int detect_wan_connectivity(const char *detect_host);
+int detect_wan_watch(const char *detect_host, int wan_fd, const char *ifname, int *event);
 
 #endif 
\ No newline at end of file
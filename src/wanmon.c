@@ -0,0 +1,232 @@
+/**
+ * @file wanmon.c
+ * @brief 外网口内核事件监听模块
+ *
+ * 主要功能：
+ * 1. 订阅RTNLGRP_LINK/RTNLGRP_IPV4_ROUTE/RTNLGRP_IPV4_IFADDR
+ * 2. 过滤出与外网设备相关的链路、默认路由和地址变化
+ * 3. 载波丢失、设备删除或默认路由全部撤销时判定为明确故障
+ * 4. 代替固定间隔的sleep，事件到达时立即唤醒检测循环；外网检测的各次ping之间也据此及早发现故障
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <syslog.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <net/route.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include "wanmon.h"
+
+/**
+ * 创建rtnetlink事件监听套接字
+ * @return 套接字描述符，-1=失败
+ */
+int wanmon_open(void) {
+    struct sockaddr_nl addr;
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        syslog(LOG_ERR, "[WanMon] 创建netlink套接字失败");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_ROUTE | RTMGRP_IPV4_IFADDR;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        syslog(LOG_ERR, "[WanMon] 订阅netlink事件失败");
+        close(fd);
+        return -1;
+    }
+
+    syslog(LOG_INFO, "[WanMon] 外网口事件监听已启动");
+    return fd;
+}
+
+// 本批消息涉及的事件类型
+#define EV_LINK  0x01
+#define EV_ROUTE 0x02
+#define EV_ADDR  0x04
+
+/**
+ * 判断链路消息是否属于外网设备
+ */
+static int parse_link(struct nlmsghdr *nh, const char *ifname) {
+    struct ifinfomsg *ifi = NLMSG_DATA(nh);
+    struct rtattr *rta = IFLA_RTA(ifi);
+    int len = IFLA_PAYLOAD(nh);
+
+    // 按名称匹配，PPPoE等设备重建后ifindex会变化
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME && strcmp(RTA_DATA(rta), ifname) == 0) {
+            return EV_LINK;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 判断路由消息是否为主路由表中的默认路由
+ */
+static int parse_route(struct nlmsghdr *nh) {
+    struct rtmsg *rtm = NLMSG_DATA(nh);
+
+    if (rtm->rtm_family != AF_INET || rtm->rtm_dst_len != 0 ||
+        rtm->rtm_table != RT_TABLE_MAIN) {
+        return 0;
+    }
+    return EV_ROUTE;
+}
+
+/**
+ * 判断地址消息是否属于外网设备
+ */
+static int parse_addr(struct nlmsghdr *nh, const char *ifname) {
+    struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+
+    return ifa->ifa_index == if_nametoindex(ifname) ? EV_ADDR : 0;
+}
+
+/**
+ * 读取一批netlink消息
+ * @return 本批消息涉及的事件类型（EV_*），读取失败返回-1
+ */
+static int read_events(int fd, const char *ifname, int flags) {
+    char buf[8192];
+    int events = 0;
+    int len = recv(fd, buf, sizeof(buf), flags);
+    if (len <= 0) {
+        return -1;
+    }
+
+    for (struct nlmsghdr *nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+        switch (nh->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+            events |= parse_link(nh, ifname);
+            break;
+        case RTM_NEWROUTE:
+        case RTM_DELROUTE:
+            events |= parse_route(nh);
+            break;
+        case RTM_NEWADDR:
+        case RTM_DELADDR:
+            events |= parse_addr(nh, ifname);
+            break;
+        }
+    }
+    return events;
+}
+
+/**
+ * 查询外网设备当前链路状态
+ * @return 1=设备不存在、未启用或无载波，0=链路正常
+ */
+static int link_down(const char *ifname) {
+    struct ifreq ifr;
+
+    if (if_nametoindex(ifname) == 0) {
+        return 1;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    int ret = ioctl(fd, SIOCGIFFLAGS, &ifr);
+    close(fd);
+    if (ret < 0) {
+        return 1;
+    }
+    return !(ifr.ifr_flags & IFF_UP) || !(ifr.ifr_flags & IFF_RUNNING);
+}
+
+/**
+ * 检查主路由表中是否仍有IPv4默认路由（/proc/net/route只列出主路由表）
+ * @return 1=存在，0=不存在
+ */
+static int has_default_route(void) {
+    char line[256], iface[IFNAMSIZ + 1];
+    unsigned long dst, gw, mask;
+    int flags, found = 0;
+
+    FILE *fp = fopen("/proc/net/route", "r");
+    if (!fp) {
+        return 1;
+    }
+    // 跳过表头
+    if (!fgets(line, sizeof(line), fp)) {
+        fclose(fp);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%16s %lx %lx %x %*d %*d %*d %lx", iface, &dst, &gw, &flags, &mask) == 5 &&
+            dst == 0 && mask == 0 && (flags & RTF_UP)) {
+            found = 1;
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+/**
+ * 等待外网口事件
+ * @param fd wanmon_open返回的套接字
+ * @param ifname 外网设备名（如pppoe-wan/eth1）
+ * @param timeout_ms 最长等待时间（毫秒），检测间隔或两次ping之间的间隔
+ * @return WANMON_TIMEOUT/WANMON_REPROBE/WANMON_DOWN
+ *
+ * 检测期间积压的事件可能包含已经恢复的中间状态（如PPPoE重拨），
+ * 因此读完所有事件后按设备当前状态而非事件本身判定。
+ */
+int wanmon_wait(int fd, const char *ifname, long timeout_ms) {
+    struct timespec start, now;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (1) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        long remain = timeout_ms - elapsed;
+        if (remain <= 0) {
+            return WANMON_TIMEOUT;
+        }
+
+        if (poll(&pfd, 1, remain) <= 0) {
+            continue;
+        }
+
+        int events = read_events(fd, ifname, 0);
+        if (events < 0) {
+            // 缓冲区溢出等错误时无法确认丢失了哪些事件，保守地按全部事件处理
+            events = EV_LINK | EV_ROUTE | EV_ADDR;
+        }
+        // 合并同一时刻突发及检测期间积压的其余事件
+        int ev;
+        while ((ev = read_events(fd, ifname, MSG_DONTWAIT)) >= 0) {
+            events |= ev;
+        }
+        if (!events) {
+            continue;
+        }
+
+        if (link_down(ifname)) {
+            syslog(LOG_NOTICE, "[WanMon] %s 载波丢失或设备已删除", ifname);
+            return WANMON_DOWN;
+        }
+        // 最后一条默认路由被撤销时外网必然不通，无需再ping确认
+        if ((events & EV_ROUTE) && !has_default_route()) {
+            syslog(LOG_NOTICE, "[WanMon] 默认路由已全部撤销");
+            return WANMON_DOWN;
+        }
+        syslog(LOG_INFO, "[WanMon] %s 链路/路由/地址变化，重新检测", ifname);
+        return WANMON_REPROBE;
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef WANMON_H
+#define WANMON_H
+
+// 外网口事件等待结果
+#define WANMON_TIMEOUT 0   // 检测间隔内无相关事件
+#define WANMON_REPROBE 1   // 路由/地址/链路恢复等事件，需立即重新检测
+#define WANMON_DOWN    2   // 载波丢失、设备消失（如PPPoE断开）或默认路由全部撤销，需立即释放网关
+
+int wanmon_open(void);
+int wanmon_wait(int fd, const char *ifname, long timeout_ms);
+
+#endif